@@ -0,0 +1,118 @@
+/*
+ * blocked_bloom_filter.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Bloom filter split into cache line sized blocks. All bits for a key are set
+ * in the same block, so each lookup touches a single cache line.
+ */
+#pragma once
+#ifndef _PTMPI_BLOCKED_BLOOM_FILTER_H_
+#define _PTMPI_BLOCKED_BLOOM_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#include "canonical_gram.h"
+
+namespace ptmpi {
+class BlockedBloomFilter {
+public:
+	/** Construct a filter using at most the specified number of bytes. */
+	explicit BlockedBloomFilter(const std::size_t bytes)
+		: _num_blocks(bytes / sizeof(Block) == 0 ? 1 : bytes / sizeof(Block)),
+			_blocks(allocate(_num_blocks))
+	{}
+	/** Add the key to the filter. */
+	void
+	insert(const std::uint64_t key) {
+		Block & block = block_for(key);
+		const std::uint64_t h = canonical::mix(key + 1);
+		for(std::uint64_t i = 0; i < num_bits; ++i) {
+			const std::uint64_t bit = bit_for(h, i);
+			block.words[bit / 64] |= std::uint64_t(1) << (bit % 64);
+		}
+	}
+	/**
+	 * Check whether the key might have been added. False positives are possible,
+	 * false negatives are not.
+	 */
+	bool
+	contains(const std::uint64_t key) const {
+		const Block & block = _blocks.get()[index_for(key)];
+		const std::uint64_t h = canonical::mix(key + 1);
+		for(std::uint64_t i = 0; i < num_bits; ++i) {
+			const std::uint64_t bit = bit_for(h, i);
+			if((block.words[bit / 64] & (std::uint64_t(1) << (bit % 64))) == 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+	/** Number of bytes used by the filter. */
+	std::size_t
+	bytes() const {
+		return _num_blocks * sizeof(Block);
+	}
+
+private:
+	static constexpr std::size_t cache_line = 64;
+	static constexpr std::uint64_t words_per_block = 8;
+	static constexpr std::uint64_t bits_per_block = 64 * words_per_block;
+	/** Number of bits set for each key. */
+	static constexpr std::uint64_t num_bits = 8;
+	struct Block {
+		std::uint64_t words[words_per_block];
+	};
+	struct Free {
+		void
+		operator()(Block * blocks) const {
+			std::free(blocks);
+		}
+	};
+	std::size_t _num_blocks;
+	/* Allocated on a cache line boundary, as new only guarantees 16 bytes. */
+	std::unique_ptr<Block[], Free> _blocks;
+
+	static Block *
+	allocate(const std::size_t num_blocks) {
+		void * memory = nullptr;
+		if(posix_memalign(&memory, cache_line, num_blocks * sizeof(Block)) != 0) {
+			throw std::bad_alloc();
+		}
+		std::memset(memory, 0, num_blocks * sizeof(Block));
+		return static_cast<Block *>(memory);
+	}
+	std::size_t
+	index_for(const std::uint64_t key) const {
+		return key % _num_blocks;
+	}
+	Block &
+	block_for(const std::uint64_t key) {
+		return _blocks.get()[index_for(key)];
+	}
+	/* Double hashing on the two halves of h gives the bit positions. */
+	static std::uint64_t
+	bit_for(const std::uint64_t h, const std::uint64_t i) {
+		return ((h & 0xffffffff) + i * ((h >> 32) | 1)) % bits_per_block;
+	}
+};
+}
+#endif
+
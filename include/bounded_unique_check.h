@@ -0,0 +1,82 @@
+/*
+ * bounded_unique_check.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Check which remembers candidates for the whole lifetime of a worker, using
+ * at most a fixed amount of memory. The memory used by the store is estimated
+ * from the sizes of its allocations, so the budget is approximate.
+ *
+ * A blocked Bloom filter over the canonical gram hash answers most queries for
+ * new candidates. Only on a filter hit are the stored gram matrices compared
+ * exactly, so a candidate is only ever rejected if it really has been seen
+ * before. Once the memory budget is used up new candidates are still added to
+ * the filter but are no longer stored, so their duplicates are let through
+ * rather than risk dropping a new result.
+ */
+#pragma once
+#ifndef _PTMPI_BOUNDED_UNIQUE_CHECK_H_
+#define _PTMPI_BOUNDED_UNIQUE_CHECK_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ptope/polytope_candidate.h"
+
+#include "blocked_bloom_filter.h"
+
+namespace ptmpi {
+class BoundedUniqueCheck {
+public:
+	/**
+	 * Construct a check using roughly the specified number of bytes. A budget of
+	 * zero disables the check, so that every candidate is unique.
+	 */
+	explicit BoundedUniqueCheck(const std::size_t bytes);
+	/**
+	 * Returns true if the candidate has not been seen before, and remembers it.
+	 */
+	bool
+	operator()(const ptope::PolytopeCandidate & pc);
+	/** Number of candidates rejected as already seen. */
+	unsigned long long
+	rejected() const {
+		return _rejected;
+	}
+	/**
+	 * Estimated number of bytes used to store seen gram matrices, including the
+	 * hash map's buckets.
+	 */
+	std::size_t
+	bytes_stored() const {
+		return _stored_bytes + _seen.bucket_count() * sizeof(void *);
+	}
+
+private:
+	bool _enabled;
+	BlockedBloomFilter _filter;
+	std::unordered_multimap<std::uint64_t, std::vector<double>> _seen;
+	std::size_t _stored_budget;
+	std::size_t _stored_bytes = 0;
+	unsigned long long _rejected = 0;
+
+	/** Store the gram matrix, if there is space left in the budget. */
+	void
+	store(const std::uint64_t hash, const double * gram, const std::size_t n);
+};
+}
+#endif
+
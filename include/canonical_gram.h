@@ -0,0 +1,74 @@
+/*
+ * canonical_gram.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Comparison of gram matrices up to reordering of the vectors. Matrices are
+ * passed as n x n arrays of doubles, so these work both on PolytopeCandidates
+ * and on matrices read back from result files.
+ */
+#pragma once
+#ifndef _PTMPI_CANONICAL_GRAM_H_
+#define _PTMPI_CANONICAL_GRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ptmpi {
+namespace canonical {
+/**
+ * Hash of the gram matrix which does not depend on the order of its rows and
+ * columns. Entries are rounded before hashing, so matrices which only differ by
+ * floating point error hash to the same value.
+ */
+std::uint64_t
+hash(const double * gram, const std::size_t n);
+/**
+ * Check whether the two gram matrices are the same up to a simultaneous
+ * permutation of rows and columns.
+ */
+bool
+equivalent(const double * a, const double * b, const std::size_t n);
+/**
+ * Hash each row of the gram matrix, independently of the order of the columns.
+ * Callers comparing the same matrix many times can keep these and use the
+ * overloads below rather than recomputing them.
+ */
+void
+row_hashes(const double * gram, const std::size_t n,
+		std::vector<std::uint64_t> & result);
+/** Same as hash, given the row hashes of the matrix. */
+std::uint64_t
+hash(const std::vector<std::uint64_t> & rows);
+/** Same as equivalent, given the row hashes of both matrices. */
+bool
+equivalent(const double * a, const std::vector<std::uint64_t> & a_rows,
+		const double * b, const std::vector<std::uint64_t> & b_rows,
+		const std::size_t n);
+/** Mix the bits of a hash, used to derive independent hashes from one. */
+inline std::uint64_t
+mix(std::uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+}
+}
+#endif
+
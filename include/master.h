@@ -18,22 +18,29 @@
 #ifndef _PTMPI_MASTER_H_
 #define _PTMPI_MASTER_H_
 
-#include <mpi.h>
+#include <chrono>
+#include <iostream>
 
 #include "ptope/polytope_candidate.h"
 
-#include "codec.h"
-#include "mpi_tags.h"
+#include "profile.h"
+#include "progress.h"
+#include "task_stats.h"
 
 namespace ptmpi {
-template <class It>
+/**
+ * Hands out the candidates from the iterator to workers. Transport is one of
+ * MPIMasterTransport or ThreadMasterTransport, see transport.h.
+ */
+template <class It, class Transport>
 class Master {
 	typedef ptope::PolytopeCandidate PolytopeCandidate;
 public:
-	Master(It && iter)
+	Master(It && iter, Transport & transport, Progress & progress)
 		: _iter(std::move(iter)),
-			_num_proc(MPI::COMM_WORLD.Get_size()),
-			_status_out("/extra/var/users/njcz19/ptope/mo")
+			_transport(transport),
+			_progress(progress),
+			_num_proc(transport.size())
 	{}
 	/**
 	 * Go through the iterator and pass polytopes to worker threads.
@@ -42,12 +49,11 @@ public:
 
 private:
 	It _iter;
+	Transport & _transport;
+	Progress & _progress;
 	int _num_proc;
-	MPI::Status _status;
-	Codec _codec;
 	std::chrono::duration<double> _time_waited{0};
 	unsigned long _no_computed = 0;
-	std::ofstream _status_out;
 	/**
 	 * Send the polytope to the specified worker thread.
 	 */
@@ -55,19 +61,20 @@ private:
 	send_matrix(const ptope::PolytopeCandidate & matrix, const int worker);
 	/**
 	 * Wait for a result from a worker. Once a result is obtained it is passed to
-	 * handle_result, before another polytope is sent to the worker.
+	 * the progress tracker, before another polytope is sent to the worker. The
+	 * worker which sent the result is stored in worker.
 	 */
-	int
-	receive_result();
+	TaskStats
+	receive_result(int & worker);
 	/**
 	 * Send shutdown signal to all worker threads.
 	 */
 	void
 	send_shutdown();
 };
-template <class It>
+template <class It, class Transport>
 void
-Master<It>::run() {
+Master<It, Transport>::run() {
 	/* 
 	 * Keep track of how many tasks were originally submitted. It could happen
 	 * that fewer tasks are generated and sent than there are cores, so don't
@@ -83,58 +90,43 @@ Master<It>::run() {
 	while(_iter.has_next()) {
 		/* Might as well compute the next polytope while waiting. */
 		auto& next = _iter.next();
-		receive_result();
-		int worker = _status.Get_source();
+		int worker;
+		receive_result(worker);
 		send_matrix(next, worker);
 	}
+	_progress.sending_done();
 	/* Wait for remaining tasks. */
 	for(uint_fast16_t i = 1; i < submitted; ++i) {
-		receive_result();
+		int worker;
+		receive_result(worker);
 	}
 	send_shutdown();
 	std::cerr << "master: Average wait " << (_time_waited.count() / _no_computed) <<"s over " << _no_computed << " tasks."
 		<< std::endl;
-	_status_out << "End: " << _no_computed << _status_out.widen('\n');
+	_progress.finish();
+	if(profile::enabled) profile::report(std::cerr);
 }
-template <class It>
+template <class It, class Transport>
 void
-Master<It>::send_matrix(const PolytopeCandidate & matrix, const int worker) {
-	int g_size = _codec.size_gram(matrix);
-	MPI::COMM_WORLD.Send(&g_size, 1, MPI::INT, worker, SIZE_TAG);
-	MPI::COMM_WORLD.Recv(NULL, 0, MPI::BYTE, worker, OK_TAG);
-	const double * gram = _codec.encode_gram(matrix);
-	MPI::COMM_WORLD.Send(gram, g_size, MPI::DOUBLE, worker, GRAM_TAG);
-	MPI::COMM_WORLD.Recv(NULL, 0, MPI::BYTE, worker, OK_TAG);
-	int v_size = _codec.size_vectors(matrix);
-	MPI::COMM_WORLD.Send(&v_size, 1, MPI::INT, worker, SIZE_TAG);
-	MPI::COMM_WORLD.Recv(NULL, 0, MPI::BYTE, worker, OK_TAG);
-	const double * vecs = _codec.encode_vectors(matrix);
-	MPI::COMM_WORLD.Send(vecs, v_size, MPI::DOUBLE, worker, VECTOR_TAG);
-	MPI::COMM_WORLD.Recv(NULL, 0, MPI::BYTE, worker, OK_TAG);
-	/* Note: do not need to delete pointers as they are managed by the
-	 * PolytopeCandidate instance. */
+Master<It, Transport>::send_matrix(const PolytopeCandidate & matrix, const int worker) {
+	_transport.send(matrix, worker);
+	_progress.task_sent(worker);
 }
-template <class It>
-int
-Master<It>::receive_result() {
-	int result;
+template <class It, class Transport>
+TaskStats
+Master<It, Transport>::receive_result(int & worker) {
 	auto start = std::chrono::system_clock::now();
-	MPI::COMM_WORLD.Recv(&result, 1, MPI::INT, MPI::ANY_SOURCE, RESULT_TAG,
-			_status);
+	TaskStats result = _transport.receive_result(worker);
 	auto end = std::chrono::system_clock::now();
 	_time_waited += (end - start);
 	++_no_computed;
-	if(_no_computed % 500 == 0) _status_out << _no_computed << ": " <<
-		_time_waited.count()/_no_computed << _status_out.widen('\n');
+	_progress.task_done(worker, result);
 	return result;
 }
-template <class It>
+template <class It, class Transport>
 void
-Master<It>::send_shutdown() {
-	int number = MPI::COMM_WORLD.Get_size();
-	for(int i = 1; i < number; ++i) {
-		MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, i, END_TAG);
-	}
+Master<It, Transport>::send_shutdown() {
+	_transport.send_shutdown();
 }
 } 
 #endif
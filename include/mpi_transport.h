@@ -0,0 +1,77 @@
+/*
+ * mpi_transport.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Master and worker transports which pass work units between MPI processes.
+ * Rank 0 is the master, all other ranks are workers.
+ */
+#pragma once
+#ifndef _PTMPI_MPI_TRANSPORT_H_
+#define _PTMPI_MPI_TRANSPORT_H_
+
+#include <mpi.h>
+
+#include "ptope/polytope_candidate.h"
+
+#include "codec.h"
+#include "transport.h"
+
+namespace ptmpi {
+class MPIMasterTransport {
+	typedef ptope::PolytopeCandidate PolytopeCandidate;
+public:
+	/** Number of processes, including the master. */
+	int
+	size();
+	/**
+	 * Send the polytope to the specified worker process.
+	 */
+	void
+	send(const PolytopeCandidate & matrix, const int worker);
+	/**
+	 * Wait for a result from any worker, and set worker to the rank it came
+	 * from.
+	 */
+	TaskStats
+	receive_result(int & worker);
+	/**
+	 * Send shutdown signal to all worker processes.
+	 */
+	void
+	send_shutdown();
+
+private:
+	MPI::Status _status;
+	Codec _codec;
+};
+class MPIWorkerTransport : public WorkerTransport {
+public:
+	bool
+	receive(ptope::PolytopeCandidate & pt) override;
+	void
+	send_result(const TaskStats & result) override;
+	int
+	id() const override;
+
+private:
+	MPI::Status _status;
+	Codec _codec;
+	arma::podarray<double> _gram_array_cache;
+	arma::podarray<double> _vect_array_cache;
+};
+}
+#endif
+
@@ -0,0 +1,168 @@
+/*
+ * profile.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Instrumentation of the master's iterator pipeline. When compiled with
+ * PTMPI_PROFILE each iterator and check in the chain is wrapped to count the
+ * candidates going in and out and the time spent in it. Otherwise the
+ * wrappers are aliases for the wrapped types and cost nothing.
+ */
+#pragma once
+#ifndef _PTMPI_PROFILE_H_
+#define _PTMPI_PROFILE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <utility>
+
+namespace ptmpi {
+namespace profile {
+/**
+ * Stages of the master's pipeline. Iterators are listed in the order that
+ * candidates pass through them, and the checks of each level are listed with
+ * the combined check first.
+ */
+enum Stage {
+	EtoL0, L0toL1, L1F, L1NoP, L1toL2, L2F, L2NoP,
+	L1Check, L1Angle, L1DuplicateColumn, L1UniquePC, L1Parabolic,
+	L2Check, L2Angle, L2DuplicateColumn, L2UniquePC, L2Parabolic,
+	NumStages
+};
+/**
+ * Counters are atomic so that the progress reporter can read them while the
+ * master is running. All updates are relaxed, as the counters are independent.
+ */
+struct StageStats {
+	/** Number of calls to a check, unused for iterators. */
+	std::atomic<unsigned long long> in{0};
+	/**
+	 * Number of candidates returned by an iterator or passed by a check. A check
+	 * passes a candidate when it returns the value the combined check expects,
+	 * which is false for some checks.
+	 */
+	std::atomic<unsigned long long> out{0};
+	/** Time spent in this stage in steady_clock ticks, including any stages it
+	 * calls. */
+	std::atomic<std::chrono::steady_clock::rep> time{0};
+	/** Approximate memory held by the stage, only set for UniquePC checks. */
+	std::atomic<std::size_t> bytes{0};
+};
+#ifdef PTMPI_PROFILE
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+/** Get the stats for the specified stage. */
+StageStats &
+stats(const Stage s);
+/** Print the stats of all stages which have seen any candidates. */
+void
+report(std::ostream & os);
+/**
+ * Whether the calling thread records stats, true by default. A thread which
+ * runs a second copy of the pipeline, such as when counting the tasks, turns
+ * this off so its work does not show up in the report.
+ */
+bool &
+recording();
+
+#ifdef PTMPI_PROFILE
+/** Add the time between construction and destruction to a stage. */
+class Timer {
+public:
+	Timer(const Stage s)
+		: _stats(stats(s)),
+			_record(recording()),
+			_start(_record ? std::chrono::steady_clock::now()
+				: std::chrono::steady_clock::time_point())
+	{}
+	~Timer() {
+		if(_record) {
+			_stats.time.fetch_add((std::chrono::steady_clock::now() - _start).count(),
+					std::memory_order_relaxed);
+		}
+	}
+private:
+	StageStats & _stats;
+	const bool _record;
+	std::chrono::steady_clock::time_point _start;
+};
+template <class It, Stage S>
+class ProfiledIterator {
+public:
+	template <class... Args>
+	ProfiledIterator(Args &&... args)
+		: _it(std::forward<Args>(args)...)
+	{}
+	ProfiledIterator(ProfiledIterator &&) = default;
+	bool
+	has_next() {
+		Timer t(S);
+		return _it.has_next();
+	}
+	auto
+	next() -> decltype(std::declval<It &>().next()) {
+		Timer t(S);
+		if(recording()) stats(S).out.fetch_add(1, std::memory_order_relaxed);
+		return _it.next();
+	}
+private:
+	It _it;
+};
+/**
+ * Wraps a check to record its stats. Pass is the value the check returns for
+ * candidates which pass it, matching the bool given with the check to the
+ * combined check or filtered iterator which uses it.
+ */
+template <class Check, Stage S, bool Pass>
+class ProfiledCheck {
+public:
+	template <class T>
+	bool
+	operator()(const T & candidate) {
+		StageStats & s = stats(S);
+		bool result;
+		{
+			Timer t(S);
+			result = _check(candidate);
+		}
+		if(!recording()) return result;
+		s.in.fetch_add(1, std::memory_order_relaxed);
+		if(result == Pass) {
+			s.out.fetch_add(1, std::memory_order_relaxed);
+			/* Each unique candidate is stored by the check. */
+			if(S == L1UniquePC || S == L2UniquePC) {
+				s.bytes.fetch_add(sizeof(T) + candidate.gram().n_elem * sizeof(double),
+						std::memory_order_relaxed);
+			}
+		}
+		return result;
+	}
+private:
+	Check _check;
+};
+#else
+template <class It, Stage S>
+using ProfiledIterator = It;
+template <class Check, Stage S, bool Pass>
+using ProfiledCheck = Check;
+#endif
+}
+}
+#endif
+
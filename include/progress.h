@@ -0,0 +1,129 @@
+/*
+ * progress.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Keeps track of how far through the run the master is, and periodically
+ * writes a snapshot of this to a file. Snapshots are written by a timer thread,
+ * so they keep coming even when no task finishes for a long time.
+ */
+#pragma once
+#ifndef _PTMPI_PROGRESS_H_
+#define _PTMPI_PROGRESS_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "task_stats.h"
+
+namespace ptmpi {
+class Progress {
+	typedef std::chrono::steady_clock Clock;
+public:
+	/**
+	 * Write snapshots to the file at path every interval seconds, which must be
+	 * positive. Workers are numbered from 1 to num_workers.
+	 */
+	Progress(const std::string & path, const double interval,
+			const int num_workers);
+	Progress(const Progress &) = delete;
+	Progress & operator=(const Progress &) = delete;
+	~Progress();
+	/**
+	 * Set the total number of tasks the master will send, used to estimate the
+	 * time remaining. If not set no estimate is given. Can be called from any
+	 * thread at any time, and is ignored once sending is done.
+	 */
+	void
+	set_total(const unsigned long long total);
+	/** Record that a task has been sent to the worker. */
+	void
+	task_sent(const int worker);
+	/**
+	 * Record that the master has sent its last task, which fixes the total to
+	 * the number of tasks sent.
+	 */
+	void
+	sending_done();
+	/** Whether sending_done has been called. Can be called from any thread. */
+	bool
+	is_sending_done() const {
+		return _sending_done.load(std::memory_order_relaxed);
+	}
+	/** Record that the worker has finished a task. */
+	void
+	task_done(const int worker, const TaskStats & stats);
+	/** Stop the timer and write the final snapshot. */
+	void
+	finish();
+
+private:
+	struct WorkerStats {
+		unsigned long long done = 0;
+		/** Seconds spent on finished tasks, as timed by the worker. */
+		double busy = 0;
+		/** Whether the worker has a task, and when it was sent. */
+		bool in_flight = false;
+		Clock::time_point sent_at;
+	};
+	/** Guards the counters below, which the timer thread reads. */
+	std::mutex _mutex;
+	std::condition_variable _stop_cv;
+	bool _stopping = false;
+	std::string _path;
+	Clock::duration _interval;
+	std::vector<WorkerStats> _workers;
+	Clock::time_point _start;
+	Clock::time_point _last_write;
+	unsigned long long _total = 0;
+	unsigned long long _sent = 0;
+	/** Also read without the mutex, to stop counting the tasks early. */
+	std::atomic<bool> _sending_done{false};
+	unsigned long long _done = 0;
+	unsigned long long _l3_found = 0;
+	unsigned long long _lo_found = 0;
+	/** Tasks done at the last snapshot, to get the throughput since then. */
+	unsigned long long _done_at_last_write = 0;
+	/** Exponentially weighted tasks per second, 0 until the first snapshot. */
+	double _rate = 0;
+	/** Only used by whichever thread writes snapshots, so not guarded. */
+	bool _warned = false;
+	/** Started last, once everything it reads is set up. */
+	std::thread _timer;
+
+	/** Write a snapshot every interval until stopped. */
+	void
+	run_timer();
+	/** Stop the timer thread and wait for it to finish. */
+	void
+	stop_timer();
+	/**
+	 * Update the rolling throughput and format a snapshot into text. Called with
+	 * the mutex held.
+	 */
+	std::string
+	snapshot(const Clock::time_point now, const bool finished);
+	/** Write a snapshot to the file, without holding the mutex. */
+	void
+	write(const std::string & text);
+};
+}
+#endif
+
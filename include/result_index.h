@@ -0,0 +1,66 @@
+/*
+ * result_index.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Format of the index written by ptmerge alongside each merged result file.
+ *
+ * The index starts with an IndexHeader, followed by header.count IndexEntry
+ * structs sorted by hash, which is the same order as the records in the result
+ * file. A polytope can be looked up by binary search on its canonical gram
+ * hash (see canonical_gram.h), and then read from the result file using the
+ * entry's offset and length without parsing anything else. All values are
+ * stored in the byte order of the machine that wrote the index.
+ *
+ * The hash must be taken of the gram matrix as printed in the result file, not
+ * of a PolytopeCandidate in memory. canonical::hash rounds entries to 1e-6, so
+ * a matrix saved with fewer digits than that will generally hash differently to
+ * the unrounded matrix it was printed from. Parse the printed values, or round
+ * them the same way the result file does, before hashing.
+ *
+ * Records whose gram matrix could not be parsed are hashed on their text
+ * instead, and have index_text_hash set in their flags. Their hash cannot be
+ * found from a gram matrix at all.
+ */
+#pragma once
+#ifndef _PTMPI_RESULT_INDEX_H_
+#define _PTMPI_RESULT_INDEX_H_
+
+#include <cstdint>
+
+namespace ptmpi {
+struct IndexHeader {
+	char magic[8];
+	std::uint64_t count;
+};
+struct IndexEntry {
+	/**
+	 * Canonical hash of the record's gram matrix as printed, or of the record's
+	 * text if index_text_hash is set in flags.
+	 */
+	std::uint64_t hash;
+	/** Byte offset of the record in the result file. */
+	std::uint64_t offset;
+	/** Length in bytes of the record, excluding the separating blank line. */
+	std::uint64_t length;
+	/** Bitwise or of the index_ flags below. */
+	std::uint64_t flags;
+};
+/** The record's gram matrix did not parse, so hash is of its text. */
+constexpr std::uint64_t index_text_hash = 1;
+constexpr char index_magic[8] = { 'P', 'T', 'I', 'D', 'X', '2', '\0', '\0' };
+}
+#endif
+
@@ -18,7 +18,8 @@
 #ifndef _PTMPI_SLAVE_H_
 #define _PTMPI_SLAVE_H_
 
-#include <mpi.h>
+#include <chrono>
+#include <fstream>
 
 #include "boost/container/flat_set.hpp"
 
@@ -28,7 +29,8 @@
 #include "ptope/unique_matrix_check.h"
 #include "ptope/vector_set.h"
 
-#include "codec.h"
+#include "bounded_unique_check.h"
+#include "transport.h"
 
 namespace ptmpi {
 class Slave {
@@ -47,14 +49,18 @@ typedef Cache<PC> PCCache;
 typedef std::vector<std::size_t> IndexVec;
 
 public:
-	Slave(unsigned int total_dimension, std::ofstream && l3_filename,
-			std::ofstream && lo_filename);
+	/**
+	 * The worker keeps track of the L3 polytopes it has found across all tasks,
+	 * using at most dedup_bytes of memory.
+	 */
+	Slave(WorkerTransport & transport, unsigned int total_dimension,
+			std::ofstream && l3_filename, std::ofstream && lo_filename,
+			std::size_t dedup_bytes);
 	void run(const bool only_compute_l3 = false);
 
 private:
+	WorkerTransport & _transport;
 	ptope::VectorSet<double> _vectors;
-	MPI::Status _status;
-	Codec _codec;
 	ptope::PolytopeCandidate _pt;
 	ptope::CompatibilityInfo _compatible;
 	ptope::PolytopeCheck _polytope_check;
@@ -62,15 +68,23 @@ private:
 	std::ofstream _lo_out;
 	PCCache _pc_cache;
 	IndexVec _added;
+	BoundedUniqueCheck _unique_l3;
+	/** Number of polytopes beyond L3 saved in the current task. */
+	unsigned long long _lo_found = 0;
+	/* Kept per worker rather than globally, as workers can share a process. */
+	unsigned long _no_computed = 0;
+	std::chrono::duration<double> _time_waited{0};
+	std::chrono::duration<double> _max_wait{0};
+	std::size_t _max_l3 = 0;
 
 	/** Get next work unit from master. */
 	bool
 	receive();
 	/** Ask master for more work. */
 	void
-	send_result(const int result);
+	send_result(const TaskStats & result);
 	/** Compute all polytopes form the most recently received thing. */
-	int
+	TaskStats
 	do_work(const bool only_compute_l3);
 	/** Add vertices until the polytope is a polytope (or times out). */
 	void
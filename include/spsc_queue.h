@@ -0,0 +1,78 @@
+/*
+ * spsc_queue.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Bounded lock-free queue with a single producer thread and a single consumer
+ * thread. Values are moved in and out of a fixed ring of slots, so no memory
+ * is allocated after construction. Use a Waiter to block on the queue.
+ */
+#pragma once
+#ifndef _PTMPI_SPSC_QUEUE_H_
+#define _PTMPI_SPSC_QUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace ptmpi {
+template <class T, std::size_t N>
+class SpscQueue {
+public:
+	/**
+	 * Move the value into the queue. Returns false if the queue is full, in
+	 * which case the value is left untouched.
+	 */
+	bool
+	try_push(T & value);
+	/**
+	 * Move the value at the front of the queue into value. Returns false if the
+	 * queue is empty.
+	 */
+	bool
+	try_pop(T & value);
+
+private:
+	/* Head and tail are written by different threads, so pad them onto
+	 * separate cache lines. Padding is used rather than alignas as queues are
+	 * heap allocated, and C++11 new ignores extended alignment. */
+	static constexpr std::size_t cache_line = 64;
+	std::atomic<std::size_t> _head{0};
+	char _head_pad[cache_line - sizeof(std::atomic<std::size_t>)];
+	std::atomic<std::size_t> _tail{0};
+	char _tail_pad[cache_line - sizeof(std::atomic<std::size_t>)];
+	std::array<T, N> _slots;
+};
+template <class T, std::size_t N>
+bool
+SpscQueue<T, N>::try_push(T & value) {
+	const std::size_t tail = _tail.load(std::memory_order_relaxed);
+	if(tail - _head.load(std::memory_order_acquire) == N) return false;
+	_slots[tail % N] = std::move(value);
+	_tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+template <class T, std::size_t N>
+bool
+SpscQueue<T, N>::try_pop(T & value) {
+	const std::size_t head = _head.load(std::memory_order_relaxed);
+	if(head == _tail.load(std::memory_order_acquire)) return false;
+	value = std::move(_slots[head % N]);
+	_head.store(head + 1, std::memory_order_release);
+	return true;
+}
+}
+#endif
+
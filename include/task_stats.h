@@ -0,0 +1,37 @@
+/*
+ * task_stats.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Summary of a finished work unit, returned by a worker with its result.
+ */
+#pragma once
+#ifndef _PTMPI_TASK_STATS_H_
+#define _PTMPI_TASK_STATS_H_
+
+namespace ptmpi {
+struct TaskStats {
+	/** Number of doubles used to send the stats over MPI. */
+	static constexpr int encoded_size = 3;
+	/** Time the worker spent computing the task. */
+	double seconds = 0;
+	/** Number of L3 polytopes saved. */
+	unsigned long long l3_found = 0;
+	/** Number of polytopes saved beyond L3. */
+	unsigned long long lo_found = 0;
+};
+}
+#endif
+
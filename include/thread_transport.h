@@ -0,0 +1,111 @@
+/*
+ * thread_transport.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Master and worker transports for running all workers as threads in a single
+ * process. Each worker has a pair of lock-free queues shared with the master,
+ * and candidates are moved through these rather than encoded with Codec.
+ */
+#pragma once
+#ifndef _PTMPI_THREAD_TRANSPORT_H_
+#define _PTMPI_THREAD_TRANSPORT_H_
+
+#include <memory>
+#include <vector>
+
+#include "ptope/polytope_candidate.h"
+
+#include "spsc_queue.h"
+#include "transport.h"
+#include "waiter.h"
+
+namespace ptmpi {
+class ThreadWorkerTransport;
+class ThreadMasterTransport {
+	typedef ptope::PolytopeCandidate PolytopeCandidate;
+	friend class ThreadWorkerTransport;
+public:
+	explicit ThreadMasterTransport(const int num_workers);
+	/** Number of workers plus one for the master, to match MPI ranks. */
+	int
+	size();
+	/**
+	 * Copy the polytope out of the master's iterator and move it to the
+	 * specified worker.
+	 */
+	void
+	send(const PolytopeCandidate & matrix, const int worker);
+	/**
+	 * Wait until any worker has returned a result, and set worker to its number.
+	 * Spins briefly, then blocks on the waiter shared by all workers.
+	 */
+	TaskStats
+	receive_result(int & worker);
+	/**
+	 * Send shutdown signal to all worker threads.
+	 */
+	void
+	send_shutdown();
+	/**
+	 * Get the worker end of the queues for the specified worker.
+	 */
+	ThreadWorkerTransport
+	worker(const int worker);
+
+private:
+	struct Task {
+		bool end = false;
+		PolytopeCandidate pc;
+	};
+	/* The master only ever has one task in flight per worker, but a little
+	 * slack lets the next task be queued before the result is read. */
+	struct Channel {
+		explicit Channel(Waiter & results_waiter)
+			: results_waiter(results_waiter)
+		{}
+		SpscQueue<Task, 2> tasks;
+		Waiter tasks_waiter;
+		SpscQueue<TaskStats, 2> results;
+		/** Shared by all channels, as the master waits on any worker. */
+		Waiter & results_waiter;
+	};
+	Waiter _results_waiter;
+	std::vector<std::unique_ptr<Channel>> _channels;
+	Task _task;
+	/** Worker to check first for a result, so no worker gets starved. */
+	std::size_t _next_poll = 0;
+};
+class ThreadWorkerTransport : public WorkerTransport {
+	typedef ThreadMasterTransport::Task Task;
+	typedef ThreadMasterTransport::Channel Channel;
+	friend class ThreadMasterTransport;
+public:
+	bool
+	receive(ptope::PolytopeCandidate & pt) override;
+	void
+	send_result(const TaskStats & result) override;
+	int
+	id() const override;
+
+private:
+	ThreadWorkerTransport(Channel & channel, const int id);
+	Channel & _channel;
+	Task _task;
+	int _id;
+};
+}
+#endif
+
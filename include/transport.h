@@ -0,0 +1,60 @@
+/*
+ * transport.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Worker side of the link between the master and a worker.
+ *
+ * The master side is a template parameter of Master, and needs to provide
+ *
+ *   int size();
+ *   void send(const PolytopeCandidate & p, const int worker);
+ *   TaskStats receive_result(int & worker);
+ *   void send_shutdown();
+ *
+ * where workers are numbered 1 to size() - 1, as with MPI ranks.
+ */
+#pragma once
+#ifndef _PTMPI_TRANSPORT_H_
+#define _PTMPI_TRANSPORT_H_
+
+#include "ptope/polytope_candidate.h"
+
+#include "task_stats.h"
+
+namespace ptmpi {
+class WorkerTransport {
+public:
+	virtual ~WorkerTransport() {}
+	/**
+	 * Wait for the next work unit from the master and store it in pt. Returns
+	 * false if the master has asked the worker to shut down.
+	 */
+	virtual bool
+	receive(ptope::PolytopeCandidate & pt) = 0;
+	/**
+	 * Tell the master that the last work unit is finished.
+	 */
+	virtual void
+	send_result(const TaskStats & result) = 0;
+	/**
+	 * Number of this worker, from 1 upwards.
+	 */
+	virtual int
+	id() const = 0;
+};
+}
+#endif
+
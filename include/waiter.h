@@ -0,0 +1,80 @@
+/*
+ * waiter.h
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Lets a thread wait for a lock-free queue without burning a core. The waiting
+ * thread spins briefly, as a new value usually turns up quickly, then sleeps on
+ * a condition variable. Producers only take the mutex when someone is asleep.
+ */
+#pragma once
+#ifndef _PTMPI_WAITER_H_
+#define _PTMPI_WAITER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ptmpi {
+class Waiter {
+public:
+	/**
+	 * Wait until ready() returns true. Only one thread may wait at a time.
+	 */
+	template <class Ready>
+	void
+	wait(Ready ready);
+	/**
+	 * Wake the waiting thread, if any. Must be called after making ready()
+	 * true.
+	 */
+	void
+	notify() {
+		/* Pairs with the fence in wait, so either the waiter sees the new value
+		 * or this sees that it is waiting. */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(_waiting.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_cv.notify_one();
+		}
+	}
+
+private:
+	static constexpr int spin_count = 100;
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	std::atomic<bool> _waiting{false};
+};
+template <class Ready>
+void
+Waiter::wait(Ready ready) {
+	for(int i = 0; i < spin_count; ++i) {
+		if(ready()) return;
+		std::this_thread::yield();
+	}
+	std::unique_lock<std::mutex> lock(_mutex);
+	_waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	/* notify takes the mutex, so it cannot slip in between this check and the
+	 * wait. */
+	while(!ready()) {
+		_cv.wait(lock);
+	}
+	_waiting.store(false, std::memory_order_relaxed);
+}
+}
+#endif
+
@@ -0,0 +1,84 @@
+/*
+ * bounded_unique_check.cc
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "bounded_unique_check.h"
+
+#include "canonical_gram.h"
+
+namespace ptmpi {
+namespace {
+/* Keys are still added to the filter once the store is full, so it gets a
+ * generous share of the budget to keep its false positive rate low. */
+constexpr std::size_t filter_fraction = 8;
+/* Bytes malloc adds to each allocation, for its header and rounding. */
+constexpr std::size_t malloc_overhead = 16;
+/* Per entry cost besides the gram matrix itself: the hash map node holding the
+ * key and vector, plus malloc's overhead on the node and the vector's buffer.
+ * The bucket array is counted separately, see store. */
+constexpr std::size_t entry_overhead = sizeof(void *) + sizeof(std::uint64_t)
+	+ sizeof(std::vector<double>) + 2 * malloc_overhead;
+std::size_t
+bucket_bytes(const std::size_t buckets) {
+	return buckets * sizeof(void *) + malloc_overhead;
+}
+}
+BoundedUniqueCheck::BoundedUniqueCheck(const std::size_t bytes)
+	: _enabled(bytes > 0),
+		_filter(bytes / filter_fraction),
+		_seen(),
+		_stored_budget(bytes > _filter.bytes() ? bytes - _filter.bytes() : 0)
+{}
+bool
+BoundedUniqueCheck::operator()(const ptope::PolytopeCandidate & pc) {
+	if(!_enabled) return true;
+	const arma::mat & gram = pc.gram();
+	const std::size_t n = gram.n_cols;
+	const std::uint64_t h = canonical::hash(gram.memptr(), n);
+	if(!_filter.contains(h)) {
+		_filter.insert(h);
+		store(h, gram.memptr(), n);
+		return true;
+	}
+	auto range = _seen.equal_range(h);
+	for(auto it = range.first; it != range.second; ++it) {
+		const std::vector<double> & seen = it->second;
+		if(seen.size() == n * n && canonical::equivalent(seen.data(), gram.memptr(), n)) {
+			++_rejected;
+			return false;
+		}
+	}
+	/* Either a false positive from the filter, or a candidate which was seen
+	 * after the budget ran out. */
+	store(h, gram.memptr(), n);
+	return true;
+}
+void
+BoundedUniqueCheck::store(const std::uint64_t hash, const double * gram,
+		const std::size_t n) {
+	const std::size_t size = n * n * sizeof(double) + entry_overhead;
+	const std::size_t buckets = _seen.bucket_count();
+	std::size_t peak = bucket_bytes(buckets);
+	if(_seen.size() + 1 > buckets * _seen.max_load_factor()) {
+		/* The map roughly doubles its buckets when it grows, and holds both the
+		 * old and new arrays while rehashing. */
+		peak += bucket_bytes(2 * buckets);
+	}
+	if(_stored_bytes + size + peak > _stored_budget) return;
+	_seen.emplace(hash, std::vector<double>(gram, gram + n * n));
+	_stored_bytes += size;
+}
+}
+
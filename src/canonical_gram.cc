@@ -0,0 +1,117 @@
+/*
+ * canonical_gram.cc
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "canonical_gram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ptmpi {
+namespace canonical {
+namespace {
+/* Gram entries are cosines of a small set of angles, so six decimal places is
+ * plenty to tell them apart. */
+constexpr double scale = 1e6;
+std::int64_t
+quantise(const double x) {
+	return std::llround(x * scale);
+}
+std::uint64_t
+combine(const std::uint64_t seed, const std::uint64_t value) {
+	return mix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+bool
+extend_match(const double * a, const double * b, const std::size_t n,
+		const std::vector<std::uint64_t> & a_rows,
+		const std::vector<std::uint64_t> & b_rows,
+		std::vector<std::size_t> & perm, std::vector<bool> & used,
+		const std::size_t i) {
+	if(i == n) return true;
+	for(std::size_t j = 0; j < n; ++j) {
+		if(used[j] || a_rows[i] != b_rows[j]) continue;
+		bool consistent = true;
+		for(std::size_t k = 0; k < i && consistent; ++k) {
+			consistent = quantise(a[k * n + i]) == quantise(b[perm[k] * n + j]);
+		}
+		if(!consistent) continue;
+		perm[i] = j;
+		used[j] = true;
+		if(extend_match(a, b, n, a_rows, b_rows, perm, used, i + 1)) return true;
+		used[j] = false;
+	}
+	return false;
+}
+}
+/* Each row is hashed from its diagonal entry and the sorted off diagonal
+ * entries. */
+void
+row_hashes(const double * gram, const std::size_t n,
+		std::vector<std::uint64_t> & result) {
+	std::vector<std::int64_t> row(n);
+	result.resize(n);
+	for(std::size_t i = 0; i < n; ++i) {
+		for(std::size_t j = 0; j < n; ++j) {
+			row[j] = quantise(gram[j * n + i]);
+		}
+		std::int64_t diag = row[i];
+		row.erase(row.begin() + i);
+		std::sort(row.begin(), row.end());
+		std::uint64_t h = combine(n, diag);
+		for(const std::int64_t x : row) {
+			h = combine(h, x);
+		}
+		result[i] = h;
+		row.resize(n);
+	}
+}
+std::uint64_t
+hash(const std::vector<std::uint64_t> & rows) {
+	std::vector<std::uint64_t> sorted(rows);
+	std::sort(sorted.begin(), sorted.end());
+	std::uint64_t h = mix(sorted.size());
+	for(const std::uint64_t r : sorted) {
+		h = combine(h, r);
+	}
+	return h;
+}
+std::uint64_t
+hash(const double * gram, const std::size_t n) {
+	std::vector<std::uint64_t> rows;
+	row_hashes(gram, n, rows);
+	return hash(rows);
+}
+bool
+equivalent(const double * a, const std::vector<std::uint64_t> & a_rows,
+		const double * b, const std::vector<std::uint64_t> & b_rows,
+		const std::size_t n) {
+	/* Rows can only be matched with rows of the same hash, and the diagonal is
+	 * part of the row hash, so only off diagonal entries need checking. */
+	std::vector<std::size_t> perm(n);
+	std::vector<bool> used(n, false);
+	return extend_match(a, b, n, a_rows, b_rows, perm, used, 0);
+}
+bool
+equivalent(const double * a, const double * b, const std::size_t n) {
+	std::vector<std::uint64_t> a_rows;
+	std::vector<std::uint64_t> b_rows;
+	row_hashes(a, n, a_rows);
+	row_hashes(b, n, b_rows);
+	return equivalent(a, a_rows, b, b_rows, n);
+}
+}
+}
+
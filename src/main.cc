@@ -18,8 +18,15 @@
 #include "slave.h"
 
 #include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
 #include <fstream>
+#include <limits>
 #include <string>
+#ifdef PTMPI_THREADS
+#include <thread>
+#include <vector>
+#endif
 
 #include "ptope/angles.h"
 #include "ptope/angle_check.h"
@@ -35,40 +42,68 @@
 #include "ptope/unique_matrix_check.h"
 
 #include "mpi_tags.h"
+#include "profile.h"
+#include "progress.h"
+#ifdef PTMPI_THREADS
+#include "thread_transport.h"
+typedef ptmpi::ThreadMasterTransport MasterTransport;
+#else
+#include "mpi_transport.h"
+typedef ptmpi::MPIMasterTransport MasterTransport;
+#endif
 
 /* These templates provide the nested iterators which handle, create and filter the stream of
- * matrices which might or might not be polytopes. */
+ * matrices which might or might not be polytopes. Each stage is tagged so that it can be
+ * profiled, see profile.h. */
 namespace iter {
-typedef ptope::CombinedCheck3<ptope::AngleCheck, true,
-	ptope::DuplicateColumnCheck, false, ptope::UniquePCCheck,
-	true> Check1;
-typedef ptope::CombinedCheck2<Check1, true, ptope::ParabolicCheck, false> Check;
+using ptmpi::profile::ProfiledCheck;
+using ptmpi::profile::ProfiledIterator;
+namespace stage = ptmpi::profile;
+
+template <stage::Stage First>
+struct Checks {
+	typedef ptope::CombinedCheck3<
+		ProfiledCheck<ptope::AngleCheck, stage::Stage(First + 1), true>, true,
+		ProfiledCheck<ptope::DuplicateColumnCheck, stage::Stage(First + 2), false>, false,
+		ProfiledCheck<ptope::UniquePCCheck, stage::Stage(First + 3), true>, true> Check1;
+	/* The combined check is used by FilteredIterator<..., true>, so passes on true. */
+	typedef ProfiledCheck<ptope::CombinedCheck2<Check1, true,
+		ProfiledCheck<ptope::ParabolicCheck, stage::Stage(First + 4), false>, false>,
+		First, true> Check;
+};
+typedef Checks<stage::L1Check>::Check L1Check;
+typedef Checks<stage::L2Check>::Check L2Check;
 
 namespace matrix {
-typedef ptope::PolytopeExtender L0toL1;
-typedef ptope::FilteredIterator<L0toL1, ptope::PolytopeCandidate, Check, true> L1F;
-typedef ptope::FilteredPrintIterator<L1F, ptope::PolytopeCandidate, ptope::PolytopeCheck, false> L1NoP;
+typedef ProfiledIterator<ptope::PolytopeExtender, stage::L0toL1> L0toL1;
+typedef ProfiledIterator<ptope::FilteredIterator<L0toL1, ptope::PolytopeCandidate, L1Check, true>, stage::L1F> L1F;
+typedef ProfiledIterator<ptope::FilteredPrintIterator<L1F, ptope::PolytopeCandidate, ptope::PolytopeCheck, false>, stage::L1NoP> L1NoP;
 
-typedef ptope::StackedIterator<L1NoP, ptope::PolytopeExtender, ptope::PolytopeCandidate> L1toL2;
-typedef ptope::FilteredIterator<L1toL2, ptope::PolytopeCandidate, Check, true> L2F;
-typedef ptope::FilteredPrintIterator<L2F, ptope::PolytopeCandidate, ptope::PolytopeCheck, false> L2NoP;
+typedef ProfiledIterator<ptope::StackedIterator<L1NoP, ptope::PolytopeExtender, ptope::PolytopeCandidate>, stage::L1toL2> L1toL2;
+typedef ProfiledIterator<ptope::FilteredIterator<L1toL2, ptope::PolytopeCandidate, L2Check, true>, stage::L2F> L2F;
+typedef ProfiledIterator<ptope::FilteredPrintIterator<L2F, ptope::PolytopeCandidate, ptope::PolytopeCheck, false>, stage::L2NoP> L2NoP;
 }
 namespace generated {
-typedef ptope::ConstructIterator<ptope::EllipticGenerator, ptope::PolytopeCandidate> EtoL0;
-typedef ptope::StackedIterator<EtoL0, ptope::PolytopeExtender, ptope::PolytopeCandidate> L0toL1;
-typedef ptope::FilteredIterator<L0toL1, ptope::PolytopeCandidate, Check, true> L1F;
-typedef ptope::FilteredPrintIterator<L1F, ptope::PolytopeCandidate, ptope::PolytopeCheck, false> L1NoP;
-
-typedef ptope::StackedIterator<L1NoP, ptope::PolytopeExtender, ptope::PolytopeCandidate> L1toL2;
-typedef ptope::FilteredIterator<L1toL2, ptope::PolytopeCandidate, Check, true> L2F;
-typedef ptope::FilteredPrintIterator<L2F, ptope::PolytopeCandidate, ptope::PolytopeCheck, false> L2NoP;
+typedef ProfiledIterator<ptope::ConstructIterator<ptope::EllipticGenerator, ptope::PolytopeCandidate>, stage::EtoL0> EtoL0;
+typedef ProfiledIterator<ptope::StackedIterator<EtoL0, ptope::PolytopeExtender, ptope::PolytopeCandidate>, stage::L0toL1> L0toL1;
+typedef ProfiledIterator<ptope::FilteredIterator<L0toL1, ptope::PolytopeCandidate, L1Check, true>, stage::L1F> L1F;
+typedef ProfiledIterator<ptope::FilteredPrintIterator<L1F, ptope::PolytopeCandidate, ptope::PolytopeCheck, false>, stage::L1NoP> L1NoP;
+
+typedef ProfiledIterator<ptope::StackedIterator<L1NoP, ptope::PolytopeExtender, ptope::PolytopeCandidate>, stage::L1toL2> L1toL2;
+typedef ProfiledIterator<ptope::FilteredIterator<L1toL2, ptope::PolytopeCandidate, L2Check, true>, stage::L2F> L2F;
+typedef ProfiledIterator<ptope::FilteredPrintIterator<L2F, ptope::PolytopeCandidate, ptope::PolytopeCheck, false>, stage::L2NoP> L2NoP;
 }
 }
 void
 usage(int rank) {
 	if(rank == MASTER) {
 		std::cout
-			<< "ptmpi [-s size] [-abde] [-f directory] [-p prefix] [-x suffix] [-3]" << std::endl
+			<< "ptmpi [-s size] [-abde] [-f directory] [-p prefix] [-x suffix] [-3] [-m MiB]" << std::endl
+			<< "      [-o progress] [-i seconds] [-c]"
+#ifdef PTMPI_THREADS
+			<< " [-t threads]"
+#endif
+			<< std::endl
 			<< " -s Specify the dimension of the space to search in" << std::endl
 			<< " -a, -b, -d, -e" << std::endl
 			<< "    Specify the initial elliptic subdiagram to start with (by Dynkin type)," << std::endl
@@ -76,7 +111,21 @@ usage(int rank) {
 			<< " -f Specify directory to store results" << std::endl
 			<< " -p Specify result file prefix" << std::endl
 			<< " -x Specify result file suffix (will be appended by mpi rank)" << std::endl
-			<< " -3 Only compute up to L3, and don't attempt to extend the L3 polytopes" << std::endl;
+			<< " -3 Only compute up to L3, and don't attempt to extend the L3 polytopes" << std::endl
+			<< " -m Memory in MiB each worker uses to avoid saving L3 polytopes already saved" << std::endl
+			<< "    in earlier tasks, defaults to 64. Use 0 to disable. This cuts duplicate" << std::endl
+			<< "    output, not computation: repeated L3 candidates are still extended. The" << std::endl
+			<< "    memory used is estimated, so the limit is approximate." << std::endl
+			<< " -o Specify file to write progress to, defaults to progress in the results" << std::endl
+			<< "    directory" << std::endl
+			<< " -i Seconds between progress updates, defaults to 60" << std::endl
+			<< " -c Count the tasks to estimate the time remaining. The master's work is" << std::endl
+			<< "    done twice to count them, on an extra core alongside the master, and" << std::endl
+			<< "    no estimate is given until the count is done." << std::endl
+#ifdef PTMPI_THREADS
+			<< " -t Number of worker threads, defaults to one less than the number of cores" << std::endl
+#endif
+			;
 	}
 }
 enum Start {
@@ -84,13 +133,12 @@ enum Start {
 };
 std::string
 filename(const std::string & dir, const std::string & prefix, const int f,
-		const int size, const std::string & suffix) {
+		const int size, const std::string & suffix, const int rank) {
 	std::string result(dir);
 	result.reserve(dir.size() + prefix.size() + suffix.size() + 8);
 	result.append("/").append(prefix).append(std::to_string(f)).append(".")
 		.append(std::to_string(size)).append(suffix);
 
-	const int rank = MPI::COMM_WORLD.Get_rank();
 	if(rank != MASTER) result.append(".").append(std::to_string(rank));
 
 	return result;
@@ -123,16 +171,116 @@ matrix_master_iter(const arma::mat & m, std::ofstream & l1_os,
 }
 template<class Iterator>
 void
-start_master(Iterator && it) {
-	ptmpi::Master<Iterator> master(std::move(it));
+start_master(Iterator && it, MasterTransport & transport,
+		ptmpi::Progress & progress) {
+	ptmpi::Master<Iterator, MasterTransport> master(std::move(it), transport,
+			progress);
 	master.run();
 }
+/*
+ * Run through the whole iterator to find how many tasks it will give. Gives up
+ * once the master has sent its last task, as the total is then known anyway.
+ */
+template<class Iterator>
+unsigned long long
+count_tasks(Iterator && it, const ptmpi::Progress & progress) {
+	unsigned long long result = 0;
+	while(!progress.is_sending_done() && it.has_next()) {
+		it.next();
+		++result;
+	}
+	return result;
+}
+arma::mat
+initial_matrix(const Start initial, const int size) {
+	switch(initial) {
+		case A:
+			return ptope::elliptic_factory::type_a(size);
+		case B:
+			return ptope::elliptic_factory::type_b(size);
+		case D:
+			return ptope::elliptic_factory::type_d(size);
+		case E:
+		default:
+			return ptope::elliptic_factory::type_e(size);
+	}
+}
+/*
+ * Run the master. If count is set the L2 stream is generated a second time on
+ * another thread, alongside the master, to count the tasks so that progress can
+ * give an estimate of the time remaining once the count is done. The count
+ * stops once the master has sent its last task.
+ */
+template<class MakeIterator>
+void
+run_master(MakeIterator make_iter, std::ofstream & l1_os,
+		std::ofstream & l2_os, MasterTransport & transport,
+		ptmpi::Progress & progress, const bool count) {
+	std::thread counter;
+	if(count) {
+		counter = std::thread([&make_iter, &progress]() {
+			/* The stages counted here are already counted by the master. */
+			ptmpi::profile::recording() = false;
+			std::ofstream null_os("/dev/null");
+			progress.set_total(count_tasks(make_iter(null_os, null_os), progress));
+		});
+	}
+	start_master(make_iter(l1_os, l2_os), transport, progress);
+	if(counter.joinable()) counter.join();
+}
+void
+run_master(const Start initial, const int size, std::ofstream & l1_os,
+		std::ofstream & l2_os, MasterTransport & transport,
+		ptmpi::Progress & progress, const bool count) {
+	if(initial == All) {
+		run_master([size](std::ofstream & l1, std::ofstream & l2) {
+					return generated_master_iter(size, l1, l2);
+				}, l1_os, l2_os, transport, progress, count);
+	} else {
+		const arma::mat m = initial_matrix(initial, size);
+		run_master([&m](std::ofstream & l1, std::ofstream & l2) {
+					return matrix_master_iter(m, l1, l2);
+				}, l1_os, l2_os, transport, progress, count);
+	}
+}
+/*
+ * Parse a number of MiB, rejecting anything which is not a non-negative number
+ * or which would overflow when converted to bytes.
+ */
+bool
+parse_mib(const char * str, std::size_t & result) {
+	char * end;
+	errno = 0;
+	const long long mib = std::strtoll(str, &end, 10);
+	if(errno != 0 || end == str || *end != '\0' || mib < 0 ||
+			static_cast<unsigned long long>(mib) >
+			(std::numeric_limits<std::size_t>::max() >> 20)) {
+		return false;
+	}
+	result = mib;
+	return true;
+}
 /* TODO input checking */
 int
 main(int argc, char* argv[]) {
 
-	MPI::Init(argc, argv);
+#ifdef PTMPI_THREADS
+	int rank = MASTER;
+	int num_threads = std::thread::hardware_concurrency() - 1;
+#else
+	/* Only the main thread makes MPI calls, but the master runs progress and
+	 * counting threads alongside it. */
+	const int provided = MPI::Init_thread(argc, argv, MPI::THREAD_FUNNELED);
 	int rank = MPI::COMM_WORLD.Get_rank();
+	if(provided < MPI::THREAD_FUNNELED) {
+		if(rank == MASTER) {
+			std::cerr << "MPI library does not support threads, which the master needs"
+				<< std::endl;
+		}
+		MPI::Finalize();
+		return 1;
+	}
+#endif
 
 	int opt;
 	int size = 0;
@@ -141,8 +289,17 @@ main(int argc, char* argv[]) {
 	std::string prefix = "l";
 	std::string suffix = ".poly";
 	bool only_l3 = false;
+	std::size_t dedup_mib = 64;
+	std::string progress_f;
+	double progress_interval = 60;
+	bool count = false;
 
-	while ((opt = getopt (argc, argv, "s:abdef:p:x:3")) != -1){
+#ifdef PTMPI_THREADS
+	const char * optstring = "s:abdef:p:x:3m:o:i:ct:";
+#else
+	const char * optstring = "s:abdef:p:x:3m:o:i:c";
+#endif
+	while ((opt = getopt (argc, argv, optstring)) != -1){
 		switch (opt) {
 			case 's':
 				size = std::atoi(optarg);
@@ -171,6 +328,32 @@ main(int argc, char* argv[]) {
 			case '3':
 				only_l3 = true;
 				break;
+			case 'm':
+				if(!parse_mib(optarg, dedup_mib)) {
+					if(rank == MASTER) std::cerr << "Invalid memory size " << optarg << std::endl;
+					usage(rank);
+					return 1;
+				}
+				break;
+			case 'o':
+				progress_f = optarg;
+				break;
+			case 'i':
+				progress_interval = std::atof(optarg);
+				if(progress_interval <= 0) {
+					if(rank == MASTER) std::cerr << "Invalid progress interval " << optarg << std::endl;
+					usage(rank);
+					return 1;
+				}
+				break;
+			case 'c':
+				count = true;
+				break;
+#ifdef PTMPI_THREADS
+			case 't':
+				num_threads = std::atoi(optarg);
+				break;
+#endif
 			case '?':
 				usage(rank);
 				return 1;
@@ -183,62 +366,89 @@ main(int argc, char* argv[]) {
 	if(size > 1) {
 		ptope::Angles::get().set_angles({2, 3, 4, 5, 8, 10});
 		if(rank == MASTER) {
-			std::string l1_f = filename(dir, prefix, 1, size, suffix);
+			std::string l1_f = filename(dir, prefix, 1, size, suffix, rank);
 			std::ofstream l1_os(l1_f);
 			if(!l1_os.is_open()) {
 				std::cerr << "Error opening file " << l1_f << std::endl;
 				return -1;
 			}
-			std::string l2_f = filename(dir, prefix, 2, size, suffix);
+			std::string l2_f = filename(dir, prefix, 2, size, suffix, rank);
 			std::ofstream l2_os(l2_f);
 			if(!l2_os.is_open()) {
 				std::cerr << "Error opening file " << l2_f << std::endl;
 				return -1;
 			}
-			switch(initial) {
-				case A:
-					start_master(matrix_master_iter(ptope::elliptic_factory::type_a(size),
-								l1_os, l2_os));
-					break;
-				case B:
-					start_master(matrix_master_iter(ptope::elliptic_factory::type_b(size),
-								l1_os, l2_os));
-					break;
-				case D:
-					start_master(matrix_master_iter(ptope::elliptic_factory::type_d(size),
-								l1_os, l2_os));
-					break;
-				case E:
-					start_master(matrix_master_iter(ptope::elliptic_factory::type_e(size),
-								l1_os, l2_os));
-					break;
-				case All:
-				default:
-					start_master(generated_master_iter(size, l1_os, l2_os));
-					break;
+#ifdef PTMPI_THREADS
+			if(num_threads < 1) num_threads = 1;
+			/* Open all worker files up front, so that no worker can fail after the
+			 * master has started handing out work. */
+			std::vector<std::ofstream> l3_oss;
+			std::vector<std::ofstream> lo_oss;
+			for(int worker = 1; worker <= num_threads; ++worker) {
+				std::string l3_f = filename(dir, prefix, 3, size, suffix, worker);
+				l3_oss.emplace_back(l3_f);
+				if(!l3_oss.back().is_open()) {
+					std::cerr << "Error opening file " << l3_f << std::endl;
+					return -1;
+				}
+				std::string lo_f = filename(dir, prefix, 4, size, suffix, worker);
+				lo_oss.emplace_back(lo_f);
+				if(!lo_oss.back().is_open()) {
+					std::cerr << "Error opening file " << lo_f << std::endl;
+					return -1;
+				}
+			}
+			MasterTransport transport(num_threads);
+			if(progress_f.empty()) progress_f = dir + "/progress";
+			ptmpi::Progress progress(progress_f, progress_interval, num_threads);
+			std::vector<std::thread> workers;
+			for(int worker = 1; worker <= num_threads; ++worker) {
+				workers.emplace_back([&, worker]() {
+					ptmpi::ThreadWorkerTransport worker_transport = transport.worker(worker);
+					ptmpi::Slave slave(worker_transport, size + 1,
+							std::move(l3_oss[worker - 1]), std::move(lo_oss[worker - 1]),
+							dedup_mib << 20);
+					slave.run(only_l3);
+				});
+			}
+			run_master(initial, size, l1_os, l2_os, transport, progress, count);
+			for(auto & w : workers) {
+				w.join();
 			}
+#else
+			MasterTransport transport;
+			if(progress_f.empty()) progress_f = dir + "/progress";
+			ptmpi::Progress progress(progress_f, progress_interval, transport.size() - 1);
+			run_master(initial, size, l1_os, l2_os, transport, progress, count);
+#endif
+#ifndef PTMPI_THREADS
 		} else {
-			std::string l3_f = filename(dir, prefix, 3, size, suffix);
+			std::string l3_f = filename(dir, prefix, 3, size, suffix, rank);
 			std::ofstream l3_os(l3_f);
 			if(!l3_os.is_open()) {
 				std::cerr << "Error opening file " << l3_f << std::endl;
 				return -1;
 			}
-			std::string lo_f = filename(dir, prefix, 4, size, suffix);
+			std::string lo_f = filename(dir, prefix, 4, size, suffix, rank);
 			std::ofstream lo_os(lo_f);
 			if(!lo_os.is_open()) {
 				std::cerr << "Error opening file " << lo_f << std::endl;
 				return -1;
 			}
-			ptmpi::Slave slave(size + 1, std::move(l3_os), std::move(lo_os));
+			ptmpi::MPIWorkerTransport transport;
+			ptmpi::Slave slave(transport, size + 1, std::move(l3_os), std::move(lo_os),
+					dedup_mib << 20);
 			slave.run(only_l3);
+#endif
 		}
 
 	} else {
 		usage(rank);
 	}
 
+#ifndef PTMPI_THREADS
 	MPI::Finalize();
+#endif
 	return 0;
 }
 
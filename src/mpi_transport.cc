@@ -0,0 +1,99 @@
+/*
+ * mpi_transport.cc
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mpi_transport.h"
+
+#include "mpi_tags.h"
+
+namespace ptmpi {
+int
+MPIMasterTransport::size() {
+	return MPI::COMM_WORLD.Get_size();
+}
+void
+MPIMasterTransport::send(const PolytopeCandidate & matrix, const int worker) {
+	int g_size = _codec.size_gram(matrix);
+	MPI::COMM_WORLD.Send(&g_size, 1, MPI::INT, worker, SIZE_TAG);
+	MPI::COMM_WORLD.Recv(NULL, 0, MPI::BYTE, worker, OK_TAG);
+	const double * gram = _codec.encode_gram(matrix);
+	MPI::COMM_WORLD.Send(gram, g_size, MPI::DOUBLE, worker, GRAM_TAG);
+	MPI::COMM_WORLD.Recv(NULL, 0, MPI::BYTE, worker, OK_TAG);
+	int v_size = _codec.size_vectors(matrix);
+	MPI::COMM_WORLD.Send(&v_size, 1, MPI::INT, worker, SIZE_TAG);
+	MPI::COMM_WORLD.Recv(NULL, 0, MPI::BYTE, worker, OK_TAG);
+	const double * vecs = _codec.encode_vectors(matrix);
+	MPI::COMM_WORLD.Send(vecs, v_size, MPI::DOUBLE, worker, VECTOR_TAG);
+	MPI::COMM_WORLD.Recv(NULL, 0, MPI::BYTE, worker, OK_TAG);
+	/* Note: do not need to delete pointers as they are managed by the
+	 * PolytopeCandidate instance. */
+}
+TaskStats
+MPIMasterTransport::receive_result(int & worker) {
+	double encoded[TaskStats::encoded_size];
+	MPI::COMM_WORLD.Recv(encoded, TaskStats::encoded_size, MPI::DOUBLE,
+			MPI::ANY_SOURCE, RESULT_TAG, _status);
+	worker = _status.Get_source();
+	TaskStats result;
+	result.seconds = encoded[0];
+	result.l3_found = encoded[1];
+	result.lo_found = encoded[2];
+	return result;
+}
+void
+MPIMasterTransport::send_shutdown() {
+	int number = MPI::COMM_WORLD.Get_size();
+	for(int i = 1; i < number; ++i) {
+		MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, i, END_TAG);
+	}
+}
+bool
+MPIWorkerTransport::receive(ptope::PolytopeCandidate & pt) {
+	int g_size = 0;
+	MPI::COMM_WORLD.Recv(&g_size, 1, MPI::INT, MASTER, MPI::ANY_TAG, _status);
+	if(_status.Get_tag() == END_TAG) {
+		return false;
+	}
+	MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, MASTER, OK_TAG);
+	_gram_array_cache.set_min_size(g_size + 2);
+	MPI::COMM_WORLD.Recv(_gram_array_cache.memptr(), g_size, MPI::DOUBLE, MASTER, GRAM_TAG);
+	MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, MASTER, OK_TAG);
+	int v_size = 0;
+	MPI::COMM_WORLD.Recv(&v_size, 1, MPI::INT, MASTER, MPI::ANY_TAG, _status);
+	MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, MASTER, OK_TAG);
+	_vect_array_cache.set_min_size(v_size + 2);
+	MPI::COMM_WORLD.Recv(_vect_array_cache.memptr(), v_size, MPI::DOUBLE, MASTER, VECTOR_TAG);
+	MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, MASTER, OK_TAG);
+
+	pt = _codec.decode(_gram_array_cache.memptr(), g_size, _vect_array_cache.memptr(), v_size);
+	return true;
+}
+void
+MPIWorkerTransport::send_result(const TaskStats & res) {
+	/* Counts are exact as doubles up to 2^53, far more than any task finds. */
+	double encoded[TaskStats::encoded_size] = {
+		res.seconds,
+		static_cast<double>(res.l3_found),
+		static_cast<double>(res.lo_found)
+	};
+	MPI::COMM_WORLD.Send(encoded, TaskStats::encoded_size, MPI::DOUBLE, MASTER,
+			RESULT_TAG);
+}
+int
+MPIWorkerTransport::id() const {
+	return MPI::COMM_WORLD.Get_rank();
+}
+}
+
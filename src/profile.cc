@@ -0,0 +1,78 @@
+/*
+ * profile.cc
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "profile.h"
+
+#include <array>
+
+namespace ptmpi {
+namespace profile {
+namespace {
+std::array<StageStats, NumStages> all_stats;
+const char * const names[NumStages] = {
+	"EtoL0", "L0toL1", "L1F", "L1NoP", "L1toL2", "L2F", "L2NoP",
+	"L1Check", "L1Angle", "L1DuplicateColumn", "L1UniquePC", "L1Parabolic",
+	"L2Check", "L2Angle", "L2DuplicateColumn", "L2UniquePC", "L2Parabolic"
+};
+double
+seconds(const std::chrono::steady_clock::rep ticks) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::duration(ticks)).count();
+}
+}
+StageStats &
+stats(const Stage s) {
+	return all_stats[s];
+}
+bool &
+recording() {
+	static thread_local bool record = true;
+	return record;
+}
+void
+report(std::ostream & os) {
+	os << "stage in out time(s) self(s) bytes" << os.widen('\n');
+	/* Each iterator pulls from the one before it, so its candidates in are the
+	 * previous stage's candidates out, and its own time excludes that stage. */
+	bool have_prev = false;
+	unsigned long long prev_out = 0;
+	double prev_time = 0;
+	for(int i = EtoL0; i <= L2NoP; ++i) {
+		const StageStats & s = all_stats[i];
+		const unsigned long long out = s.out.load(std::memory_order_relaxed);
+		const double time = seconds(s.time.load(std::memory_order_relaxed));
+		if(out == 0 && time == 0) continue;
+		unsigned long long in = have_prev ? prev_out : 0;
+		double self = time - (have_prev ? prev_time : 0);
+		os << names[i] << ' ' << in << ' ' << out << ' ' << time << ' ' << self
+			<< ' ' << s.bytes.load(std::memory_order_relaxed) << os.widen('\n');
+		have_prev = true;
+		prev_out = out;
+		prev_time = time;
+	}
+	for(int i = L1Check; i < NumStages; ++i) {
+		const StageStats & s = all_stats[i];
+		const unsigned long long in = s.in.load(std::memory_order_relaxed);
+		if(in == 0) continue;
+		const double time = seconds(s.time.load(std::memory_order_relaxed));
+		os << names[i] << ' ' << in << ' ' << s.out.load(std::memory_order_relaxed)
+			<< ' ' << time << ' ' << time << ' '
+			<< s.bytes.load(std::memory_order_relaxed) << os.widen('\n');
+	}
+	os.flush();
+}
+}
+}
+
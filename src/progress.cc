@@ -0,0 +1,170 @@
+/*
+ * progress.cc
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "progress.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "profile.h"
+
+namespace ptmpi {
+namespace {
+/* Weight of the latest interval in the rolling throughput. Tasks vary wildly
+ * in cost, so this smooths over several intervals. */
+constexpr double rate_weight = 0.2;
+double
+seconds(const std::chrono::steady_clock::duration & d) {
+	return std::chrono::duration<double>(d).count();
+}
+}
+Progress::Progress(const std::string & path, const double interval,
+		const int num_workers)
+	: _path(path),
+		_interval(std::chrono::duration_cast<Clock::duration>(
+					std::chrono::duration<double>(interval))),
+		_workers(num_workers),
+		_start(Clock::now()),
+		_last_write(_start),
+		_timer(&Progress::run_timer, this)
+{}
+Progress::~Progress() {
+	stop_timer();
+}
+void
+Progress::set_total(const unsigned long long total) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if(!_sending_done) _total = total;
+}
+void
+Progress::task_sent(const int worker) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	++_sent;
+	WorkerStats & w = _workers[worker - 1];
+	w.in_flight = true;
+	w.sent_at = Clock::now();
+}
+void
+Progress::sending_done() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_total = _sent;
+	_sending_done = true;
+}
+void
+Progress::task_done(const int worker, const TaskStats & stats) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	++_done;
+	_l3_found += stats.l3_found;
+	_lo_found += stats.lo_found;
+	WorkerStats & w = _workers[worker - 1];
+	++w.done;
+	w.busy += stats.seconds;
+	w.in_flight = false;
+}
+void
+Progress::finish() {
+	stop_timer();
+	std::string text;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		text = snapshot(Clock::now(), true);
+	}
+	write(text);
+}
+void
+Progress::run_timer() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	while(!_stop_cv.wait_until(lock, _last_write + _interval,
+				[this]() { return _stopping; })) {
+		std::string text = snapshot(Clock::now(), false);
+		lock.unlock();
+		write(text);
+		lock.lock();
+	}
+}
+void
+Progress::stop_timer() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_stop_cv.notify_one();
+	if(_timer.joinable()) _timer.join();
+}
+std::string
+Progress::snapshot(const Clock::time_point now, const bool finished) {
+	double window = seconds(now - _last_write);
+	if(window > 0) {
+		double window_rate = (_done - _done_at_last_write) / window;
+		_rate = _rate == 0 ? window_rate
+			: rate_weight * window_rate + (1 - rate_weight) * _rate;
+	}
+	_last_write = now;
+	_done_at_last_write = _done;
+
+	std::ostringstream os;
+	const double elapsed = seconds(now - _start);
+	os << "status: " << (finished ? "finished" : "running") << '\n'
+		<< "elapsed: " << elapsed << '\n'
+		<< "tasks_done: " << _done << '\n'
+		<< "tasks_in_flight: " << (_sent - _done) << '\n'
+		<< "tasks_per_second: " << _rate << '\n'
+		<< "l3_found: " << _l3_found << '\n'
+		<< "l3_per_second: " << (elapsed > 0 ? _l3_found / elapsed : 0) << '\n'
+		<< "lo_found: " << _lo_found << '\n'
+		<< "lo_per_second: " << (elapsed > 0 ? _lo_found / elapsed : 0) << '\n';
+	if(_total > 0) {
+		os << "tasks_total: " << _total << '\n'
+			<< "tasks_remaining: " << (_total > _done ? _total - _done : 0) << '\n';
+		if(!finished && _rate > 0) {
+			os << "eta_seconds: " << (_total > _done ? _total - _done : 0) / _rate << '\n';
+		}
+	}
+	os << "worker tasks busy idle" << '\n';
+	for(std::size_t i = 0; i < _workers.size(); ++i) {
+		const WorkerStats & w = _workers[i];
+		/* A task still running counts as busy from when it was sent, so that a
+		 * worker stuck on one long task does not show as idle. */
+		double busy_seconds = w.busy;
+		if(w.in_flight) busy_seconds += seconds(now - w.sent_at);
+		double busy = elapsed > 0 ? busy_seconds / elapsed : 0;
+		if(busy > 1) busy = 1;
+		os << (i + 1) << ' ' << w.done << ' ' << busy << ' ' << (1 - busy) << '\n';
+	}
+	if(profile::enabled) profile::report(os);
+	return os.str();
+}
+void
+Progress::write(const std::string & text) {
+	/* Write to a temporary file and rename it, so that anyone reading the
+	 * snapshot never sees a partial one. */
+	const std::string tmp = _path + ".tmp";
+	std::ofstream os(tmp);
+	if(!os.is_open()) {
+		if(!_warned) std::cerr << "Error opening file " << tmp << std::endl;
+		_warned = true;
+		return;
+	}
+	os << text;
+	os.close();
+	if(!os || std::rename(tmp.c_str(), _path.c_str()) != 0) {
+		if(!_warned) std::cerr << "Error writing file " << _path << std::endl;
+		_warned = true;
+	}
+}
+}
@@ -29,9 +29,6 @@
 #include "ptope/stacked_iterator.h"
 #include "ptope/elliptic_factory.h"
 
-#include "codec.h"
-#include "mpi_tags.h"
-
 namespace ptmpi {
 namespace {
 typedef ptope::StackedIterator<ptope::PolytopeRebaser, ptope::PolytopeExtender,
@@ -39,80 +36,66 @@ typedef ptope::StackedIterator<ptope::PolytopeRebaser, ptope::PolytopeExtender,
 typedef ptope::CombinedCheck3<ptope::AngleCheck, true, ptope::UniquePCCheck, true,
 				ptope::DuplicateColumnCheck, false> Check;
 typedef ptope::FilteredIterator<PCtoL3, ptope::PolytopeCandidate, Check, true> L3F;
-
-unsigned long no_computed = 0;
-std::chrono::duration<double> time_waited(0);
-std::chrono::duration<double> max_wait(0);
-std::size_t max_l3(0);
 }
-Slave::Slave(unsigned int total_dimension, std::ofstream && l3_os, std::ofstream && lo_os)
-	: _vectors(total_dimension, 9500)
+Slave::Slave(WorkerTransport & transport, unsigned int total_dimension,
+		std::ofstream && l3_os, std::ofstream && lo_os, std::size_t dedup_bytes)
+	: _transport(transport)
+	, _vectors(total_dimension, 9500)
 	, _l3_out(std::move(l3_os))
 	, _lo_out(std::move(lo_os))
 	, _added(max_depth)
+	, _unique_l3(dedup_bytes)
 {}
 
 void
 Slave::run(const bool only_compute_l3) {
 	while(receive()) {
-		int result = do_work(only_compute_l3);
+		TaskStats result = do_work(only_compute_l3);
 		send_result(result);
 	}
-	std::cerr << "worker " << MPI::COMM_WORLD.Get_rank() << ": Average wait "
-		<< (time_waited.count() / no_computed) << ", max " << max_wait.count()
-		<< " with largest L3: " << max_l3
+	std::cerr << "worker " << _transport.id() << ": Average wait "
+		<< (_time_waited.count() / _no_computed) << ", max " << _max_wait.count()
+		<< " with largest L3: " << _max_l3
+		<< ", repeated L3 skipped: " << _unique_l3.rejected()
 		<< std::cerr.widen('\n');
 }
 bool
 Slave::receive() {
-	static arma::podarray<double> __gram_array_cache;
-	static arma::podarray<double> __vect_array_cache;
-	int g_size = 0;
-	MPI::COMM_WORLD.Recv(&g_size, 1, MPI::INT, MASTER, MPI::ANY_TAG, _status);
-	if(_status.Get_tag() == END_TAG) {
-		return false;
-	}
-	MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, MASTER, OK_TAG);
-	__gram_array_cache.set_min_size(g_size + 2);
-	MPI::COMM_WORLD.Recv(__gram_array_cache.memptr(), g_size, MPI::DOUBLE, MASTER, GRAM_TAG);
-	MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, MASTER, OK_TAG);
-	int v_size = 0;
-	MPI::COMM_WORLD.Recv(&v_size, 1, MPI::INT, MASTER, MPI::ANY_TAG, _status);
-	MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, MASTER, OK_TAG);
-	__vect_array_cache.set_min_size(v_size + 2);
-	MPI::COMM_WORLD.Recv(__vect_array_cache.memptr(), v_size, MPI::DOUBLE, MASTER, VECTOR_TAG);
-	MPI::COMM_WORLD.Send(NULL, 0, MPI::BYTE, MASTER, OK_TAG);
-
-	_pt = _codec.decode(__gram_array_cache.memptr(), g_size, __vect_array_cache.memptr(), v_size);
-	return true;
+	return _transport.receive(_pt);
 }
 void
-Slave::send_result(const int res) {
+Slave::send_result(const TaskStats & res) {
 	auto start = std::chrono::system_clock::now();
-	MPI::COMM_WORLD.Send(&res, 1, MPI::INT, MASTER, RESULT_TAG);
+	_transport.send_result(res);
 	auto end = std::chrono::system_clock::now();
 	std::chrono::duration<double> diff = end - start;
-	time_waited += diff;
-	if(diff > max_wait) max_wait = diff;
-	++no_computed;
+	_time_waited += diff;
+	if(diff > _max_wait) _max_wait = diff;
+	++_no_computed;
 }
-int
+TaskStats
 Slave::do_work(const bool only_compute_l3) {
-	//static ptope::BloomPCCheck unique_check;
+	TaskStats result;
+	auto start = std::chrono::steady_clock::now();
+	_lo_found = 0;
 	PCtoL3 l3_iter(_pt);
 	L3F l3(std::move(l3_iter));
 	const arma::uword last_vec_ind = _pt.vector_family().size();
 	while(l3.has_next()) {
 		auto & n = l3.next();
-		//if ( unique_check(n) ) {
 		if(_polytope_check(n)) {
-			n.save(_l3_out);
+			/* Earlier tasks may already have found this polytope. */
+			if(_unique_l3(n)) {
+				n.save(_l3_out);
+				++result.l3_found;
+			}
 		} else {
+			/* Repeated non-polytopes are still extended, as the vectors they are
+			 * extended by depend on this task's base polytope. */
 			_vectors.add( n.vector_family().get_ptr(last_vec_ind) );
 		}
-		//}
 	}
-	if(_vectors.size() > max_l3) { max_l3 = _vectors.size(); }
+	if(_vectors.size() > _max_l3) { _max_l3 = _vectors.size(); }
 	if( !only_compute_l3 ) { 
 		_compatible.from( _vectors );
 		// Don't actually need to check the last one because of how it will have been
@@ -123,7 +106,10 @@ Slave::do_work(const bool only_compute_l3) {
 		}
 	}
 	_vectors.clear();
-	return 0;
+	result.lo_found = _lo_found;
+	result.seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	return result;
 }
 void
 Slave::add_till_polytope(std::size_t index) {
@@ -151,6 +137,7 @@ Slave::add_till_polytope(const PC & p, std::size_t index_to_add,
 	p.extend_by_vector(next_pc, vec_to_add);
 	if(_polytope_check(next_pc)) {
 		next_pc.save(_lo_out);
+		++_lo_found;
 	} else if(depth != max_depth) {
 		added[depth] = index_to_add;
 		std::size_t next_ind = _compatible.next_compatible_to( index_to_add , 0 );
@@ -0,0 +1,113 @@
+/*
+ * thread_transport.cc
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "thread_transport.h"
+
+#include <chrono>
+#include <thread>
+
+namespace ptmpi {
+namespace {
+/**
+ * Push the value, waiting if the queue is full. The master and worker never
+ * have more than one task in flight, so this only happens briefly if at all.
+ */
+template <class Queue, class T>
+void
+push(Queue & queue, T & value) {
+	while(!queue.try_push(value)) {
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+}
+}
+ThreadMasterTransport::ThreadMasterTransport(const int num_workers)
+	: _channels()
+{
+	_channels.reserve(num_workers);
+	for(int i = 0; i < num_workers; ++i) {
+		_channels.emplace_back(new Channel(_results_waiter));
+	}
+}
+int
+ThreadMasterTransport::size() {
+	return _channels.size() + 1;
+}
+void
+ThreadMasterTransport::send(const PolytopeCandidate & matrix, const int worker) {
+	/* The iterator owns the candidate, so it has to be copied once here. After
+	 * that it is only ever moved. */
+	_task.end = false;
+	_task.pc = matrix;
+	Channel & channel = *_channels[worker - 1];
+	push(channel.tasks, _task);
+	channel.tasks_waiter.notify();
+}
+TaskStats
+ThreadMasterTransport::receive_result(int & worker) {
+	TaskStats result;
+	const std::size_t num = _channels.size();
+	bool found = false;
+	_results_waiter.wait([&]() {
+		for(std::size_t i = 0; i < num; ++i) {
+			std::size_t ind = (_next_poll + i) % num;
+			if(_channels[ind]->results.try_pop(result)) {
+				_next_poll = (ind + 1) % num;
+				worker = ind + 1;
+				found = true;
+				break;
+			}
+		}
+		return found;
+	});
+	return result;
+}
+void
+ThreadMasterTransport::send_shutdown() {
+	for(auto & channel : _channels) {
+		_task.end = true;
+		push(channel->tasks, _task);
+		channel->tasks_waiter.notify();
+	}
+}
+ThreadWorkerTransport
+ThreadMasterTransport::worker(const int worker) {
+	return ThreadWorkerTransport(*_channels[worker - 1], worker);
+}
+ThreadWorkerTransport::ThreadWorkerTransport(Channel & channel, const int id)
+	: _channel(channel),
+		_id(id)
+{}
+bool
+ThreadWorkerTransport::receive(ptope::PolytopeCandidate & pt) {
+	_channel.tasks_waiter.wait([this]() { return _channel.tasks.try_pop(_task); });
+	if(_task.end) {
+		return false;
+	}
+	pt = std::move(_task.pc);
+	return true;
+}
+void
+ThreadWorkerTransport::send_result(const TaskStats & result) {
+	TaskStats res = result;
+	push(_channel.results, res);
+	_channel.results_waiter.notify();
+}
+int
+ThreadWorkerTransport::id() const {
+	return _id;
+}
+}
+
@@ -0,0 +1,514 @@
+/*
+ * ptmerge.cc
+ * Copyright 2015 John Lawson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * Merge the per rank result files from a run into one sorted, deduplicated
+ * file per level, along with an index of the records (see result_index.h).
+ *
+ * Input files are grouped by name with any trailing rank removed, so
+ * l3.7.poly.1, l3.7.poly.2, ... are merged into l3.7.poly in the output
+ * directory.
+ *
+ * The parser is written against this record format:
+ *
+ *   - records are separated by one or more blank (or whitespace only) lines,
+ *     and a record contains no blank lines;
+ *   - the first n lines of a record are the n x n gram matrix, one row per
+ *     line, as whitespace separated numbers readable by strtod, with no header
+ *     line before it;
+ *   - any further lines (the vector family) are kept verbatim but not parsed.
+ *
+ * The gram matrix identifies the polytope up to reordering of its vectors.
+ * ptope's PolytopeCandidate::save is not part of this repository, so this
+ * format is checked on every run rather than trusted: records which do not
+ * start with a square matrix can only be merged with byte identical records,
+ * so they are counted and reported. If no record of a level parses, the format
+ * does not match and nothing could be deduplicated, so the tool fails unless
+ * -t is given.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "canonical_gram.h"
+#include "result_index.h"
+
+namespace {
+/** Read only memory map of a whole file. */
+class MappedFile {
+public:
+	explicit MappedFile(const std::string & path);
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+	bool
+	ok() const {
+		return _ok;
+	}
+	const char *
+	data() const {
+		return _data;
+	}
+	std::size_t
+	size() const {
+		return _size;
+	}
+private:
+	bool _ok = false;
+	const char * _data = nullptr;
+	std::size_t _size = 0;
+};
+MappedFile::MappedFile(const std::string & path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) return;
+	struct stat st;
+	if(fstat(fd, &st) == 0) {
+		_size = st.st_size;
+		if(_size == 0) {
+			_ok = true;
+		} else {
+			void * map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(map != MAP_FAILED) {
+				madvise(map, _size, MADV_SEQUENTIAL);
+				_data = static_cast<const char *>(map);
+				_ok = true;
+			}
+		}
+	}
+	close(fd);
+}
+MappedFile::~MappedFile() {
+	if(_data != nullptr) munmap(const_cast<char *>(_data), _size);
+}
+
+struct Record {
+	const char * data;
+	std::size_t length;
+	std::uint64_t hash;
+	/** Whether the hash is a canonical gram hash, or just of the text. */
+	bool canonical;
+	/** Parsed gram matrix and its row hashes, empty if not canonical. */
+	std::vector<double> gram;
+	std::vector<std::uint64_t> rows;
+};
+/** Part of a file which only contains whole records. */
+struct Chunk {
+	const char * begin;
+	const char * end;
+};
+
+const char *
+line_end(const char * p, const char * end) {
+	const char * nl = static_cast<const char *>(std::memchr(p, '\n', end - p));
+	return nl == nullptr ? end : nl;
+}
+bool
+is_blank(const char * begin, const char * end) {
+	for(; begin != end; ++begin) {
+		if(!std::isspace(static_cast<unsigned char>(*begin))) return false;
+	}
+	return true;
+}
+/**
+ * Get the start of the first record at or after p, which is the start of the
+ * file or the first line after a blank line.
+ */
+const char *
+record_start(const char * file, const char * p, const char * end) {
+	if(p == file) return p;
+	/* Move to the start of the next line, then past the next blank line. */
+	p = line_end(p - 1, end);
+	while(p != end) {
+		const char * line = p + 1;
+		p = line_end(line, end);
+		if(is_blank(line, p)) return p == end ? end : p + 1;
+	}
+	return end;
+}
+/** Split the text of a line into numbers. Returns false if any is invalid. */
+bool
+parse_numbers(const char * begin, const char * end, std::vector<double> & out) {
+	std::string line(begin, end);
+	const char * p = line.c_str();
+	for(;;) {
+		while(std::isspace(static_cast<unsigned char>(*p))) ++p;
+		if(*p == '\0') return true;
+		char * next;
+		out.push_back(std::strtod(p, &next));
+		if(next == p) return false;
+		p = next;
+	}
+}
+/**
+ * Read the gram matrix at the start of the record. Returns the size of the
+ * matrix, or 0 if the record does not start with a square matrix.
+ */
+std::size_t
+parse_gram(const Record & r, std::vector<double> & gram) {
+	gram.clear();
+	const char * end = r.data + r.length;
+	const char * line = r.data;
+	const char * eol = line_end(line, end);
+	if(!parse_numbers(line, eol, gram) || gram.empty()) return 0;
+	const std::size_t n = gram.size();
+	for(std::size_t row = 1; row < n; ++row) {
+		if(eol == end) return 0;
+		line = eol + 1;
+		eol = line_end(line, end);
+		if(!parse_numbers(line, eol, gram) || gram.size() != (row + 1) * n) return 0;
+	}
+	return n;
+}
+std::uint64_t
+text_hash(const char * data, const std::size_t length) {
+	/* FNV-1a */
+	std::uint64_t h = 0xcbf29ce484222325ULL;
+	for(std::size_t i = 0; i < length; ++i) {
+		h ^= static_cast<unsigned char>(data[i]);
+		h *= 0x100000001b3ULL;
+	}
+	return ptmpi::canonical::mix(h);
+}
+bool
+text_less(const Record & a, const Record & b) {
+	int cmp = std::memcmp(a.data, b.data, std::min(a.length, b.length));
+	return cmp != 0 ? cmp < 0 : a.length < b.length;
+}
+bool
+same_polytope(const Record & a, const Record & b) {
+	if(a.canonical != b.canonical) return false;
+	if(!a.canonical) {
+		return a.length == b.length && std::memcmp(a.data, b.data, a.length) == 0;
+	}
+	return a.rows.size() == b.rows.size() &&
+		ptmpi::canonical::equivalent(a.gram.data(), a.rows, b.gram.data(), b.rows,
+				a.rows.size());
+}
+
+/**
+ * Concurrent set of records. Records are sharded on the top bits of their hash,
+ * so that each shard holds a contiguous range of hashes and the shards can be
+ * sorted independently.
+ */
+class ShardedRecordSet {
+public:
+	static constexpr int shard_bits = 8;
+	static constexpr std::size_t num_shards = std::size_t(1) << shard_bits;
+	/**
+	 * Add the record, unless the same polytope is already in the set. Of two
+	 * records of the same polytope the one with the smaller text is kept, so the
+	 * result does not depend on the order records are inserted.
+	 */
+	void
+	insert(Record && r);
+	/** Sort the records in the specified shard by hash. */
+	void
+	sort_shard(const std::size_t shard);
+	/** Get the records in the specified shard. */
+	const std::vector<Record> &
+	records(const std::size_t shard) const {
+		return _shards[shard].records;
+	}
+private:
+	struct Shard {
+		std::mutex mutex;
+		std::vector<Record> records;
+		std::unordered_multimap<std::uint64_t, std::size_t> by_hash;
+	};
+	Shard _shards[num_shards];
+};
+void
+ShardedRecordSet::insert(Record && r) {
+	Shard & shard = _shards[r.hash >> (64 - shard_bits)];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto range = shard.by_hash.equal_range(r.hash);
+	for(auto it = range.first; it != range.second; ++it) {
+		Record & existing = shard.records[it->second];
+		if(same_polytope(existing, r)) {
+			if(text_less(r, existing)) existing = std::move(r);
+			return;
+		}
+	}
+	shard.by_hash.emplace(r.hash, shard.records.size());
+	shard.records.push_back(std::move(r));
+}
+void
+ShardedRecordSet::sort_shard(const std::size_t shard) {
+	std::vector<Record> & records = _shards[shard].records;
+	/* Break ties on the text so the output does not depend on thread timing. */
+	std::sort(records.begin(), records.end(),
+		[](const Record & a, const Record & b) {
+			return a.hash != b.hash ? a.hash < b.hash : text_less(a, b);
+		});
+	_shards[shard].by_hash.clear();
+}
+
+/** Run f(i) for each i in [0, count) using the specified number of threads. */
+template <class F>
+void
+parallel_for(const std::size_t count, const int threads, F f) {
+	std::atomic<std::size_t> next(0);
+	std::vector<std::thread> pool;
+	for(int t = 0; t < threads; ++t) {
+		pool.emplace_back([&]() {
+			for(std::size_t i = next++; i < count; i = next++) {
+				f(i);
+			}
+		});
+	}
+	for(auto & t : pool) t.join();
+}
+/** Split the file into chunks of whole records of roughly the given size. */
+void
+split(const MappedFile & file, const std::size_t chunk_size,
+		std::vector<Chunk> & chunks) {
+	const char * begin = file.data();
+	const char * end = begin + file.size();
+	const char * p = begin;
+	while(p != end) {
+		const char * next = end - p > static_cast<std::ptrdiff_t>(chunk_size)
+			? record_start(begin, p + chunk_size, end) : end;
+		chunks.push_back({ p, next });
+		p = next;
+	}
+}
+/** Counts of records read, and of those which are not gram matrices. */
+struct ParseCounts {
+	std::atomic<unsigned long long> records{0};
+	std::atomic<unsigned long long> unparsed{0};
+};
+void
+parse_chunk(const Chunk & chunk, ShardedRecordSet & set, ParseCounts & counts) {
+	unsigned long long records = 0;
+	unsigned long long unparsed = 0;
+	const char * p = chunk.begin;
+	while(p != chunk.end) {
+		/* Skip blank lines, then take lines until the next blank one. */
+		const char * eol = line_end(p, chunk.end);
+		if(is_blank(p, eol)) {
+			p = eol == chunk.end ? eol : eol + 1;
+			continue;
+		}
+		const char * start = p;
+		const char * last = eol;
+		while(eol != chunk.end) {
+			p = eol + 1;
+			eol = line_end(p, chunk.end);
+			if(is_blank(p, eol)) break;
+			last = eol;
+		}
+		Record r;
+		r.data = start;
+		/* Keep the record's final newline, if it has one. */
+		r.length = (last == chunk.end ? last : last + 1) - start;
+		/* The parsed gram is kept with the record, so comparing it with later
+		 * duplicates needs no parsing. */
+		std::size_t n = parse_gram(r, r.gram);
+		r.canonical = n > 0;
+		if(r.canonical) {
+			ptmpi::canonical::row_hashes(r.gram.data(), n, r.rows);
+			r.hash = ptmpi::canonical::hash(r.rows);
+		} else {
+			r.gram.clear();
+			r.hash = text_hash(r.data, r.length);
+			++unparsed;
+		}
+		++records;
+		set.insert(std::move(r));
+		p = eol == chunk.end ? eol : eol + 1;
+	}
+	counts.records += records;
+	counts.unparsed += unparsed;
+}
+bool
+same_file(const std::string & a, const std::string & b) {
+	struct stat sa;
+	struct stat sb;
+	return stat(a.c_str(), &sa) == 0 && stat(b.c_str(), &sb) == 0 &&
+		sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+/** Name of the merged output, with any trailing rank removed. */
+std::string
+merged_name(const std::string & path) {
+	std::string name = path.substr(path.find_last_of('/') + 1);
+	std::size_t dot = name.find_last_of('.');
+	if(dot != std::string::npos && dot + 1 < name.size() &&
+			name.find_first_not_of("0123456789", dot + 1) == std::string::npos) {
+		name.erase(dot);
+	}
+	return name;
+}
+/**
+ * Merge all inputs into the output file and write its index. Returns the number
+ * of records written, or -1 on error.
+ */
+long long
+merge(const std::vector<std::string> & inputs, const std::string & output,
+		const int threads, const bool allow_text) {
+	std::vector<std::unique_ptr<MappedFile>> files;
+	std::size_t total = 0;
+	for(const std::string & in : inputs) {
+		files.emplace_back(new MappedFile(in));
+		if(!files.back()->ok()) {
+			std::cerr << "Error reading file " << in << std::endl;
+			return -1;
+		}
+		total += files.back()->size();
+	}
+	/* Plenty of chunks per thread to balance load, but not so small that
+	 * finding record boundaries dominates. */
+	const std::size_t chunk_size = std::max<std::size_t>(total / (threads * 16), 1 << 20);
+	std::vector<Chunk> chunks;
+	for(const auto & file : files) {
+		split(*file, chunk_size, chunks);
+	}
+	ShardedRecordSet set;
+	ParseCounts counts;
+	parallel_for(chunks.size(), threads,
+			[&](std::size_t i) { parse_chunk(chunks[i], set, counts); });
+	if(counts.unparsed > 0) {
+		std::cerr << "WARNING: " << output << ": " << counts.unparsed << " of "
+			<< counts.records << " records do not start with a gram matrix, and are"
+			<< " only deduplicated if byte identical" << std::endl;
+		if(counts.unparsed == counts.records && !allow_text) {
+			std::cerr << "Error: no record parsed, so the input does not match the"
+				<< " expected format. Use -t to merge by exact text anyway."
+				<< std::endl;
+			return -1;
+		}
+	}
+	parallel_for(ShardedRecordSet::num_shards, threads,
+			[&](std::size_t i) { set.sort_shard(i); });
+
+	std::ofstream out(output, std::ios::binary);
+	std::ofstream idx(output + ".idx", std::ios::binary);
+	if(!out.is_open() || !idx.is_open()) {
+		std::cerr << "Error opening file " << output << std::endl;
+		return -1;
+	}
+	std::vector<ptmpi::IndexEntry> entries;
+	std::uint64_t offset = 0;
+	for(std::size_t s = 0; s < ShardedRecordSet::num_shards; ++s) {
+		for(const Record & r : set.records(s)) {
+			out.write(r.data, r.length);
+			entries.push_back({ r.hash, offset, r.length,
+					r.canonical ? 0 : ptmpi::index_text_hash });
+			offset += r.length;
+			/* Records which ended the file may be missing their newline. */
+			if(r.data[r.length - 1] != '\n') {
+				out.put('\n');
+				++offset;
+			}
+			out.put('\n');
+			++offset;
+		}
+	}
+	ptmpi::IndexHeader header;
+	std::memcpy(header.magic, ptmpi::index_magic, sizeof(header.magic));
+	header.count = entries.size();
+	idx.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	idx.write(reinterpret_cast<const char *>(entries.data()),
+			entries.size() * sizeof(ptmpi::IndexEntry));
+	out.close();
+	idx.close();
+	if(!out || !idx) {
+		std::cerr << "Error writing file " << output << std::endl;
+		return -1;
+	}
+	return entries.size();
+}
+void
+usage() {
+	std::cout
+		<< "ptmerge [-o directory] [-j threads] [-t] file..." << std::endl
+		<< " -o Specify directory to write merged files to, defaults to ." << std::endl
+		<< " -j Number of threads to use, defaults to the number of cores" << std::endl
+		<< " -t Merge inputs even if no record starts with a gram matrix, removing" << std::endl
+		<< "    only byte identical duplicates" << std::endl;
+}
+}
+int
+main(int argc, char* argv[]) {
+	int opt;
+	std::string dir = ".";
+	int threads = std::thread::hardware_concurrency();
+	bool allow_text = false;
+
+	while ((opt = getopt (argc, argv, "o:j:t")) != -1){
+		switch (opt) {
+			case 'o':
+				dir = optarg;
+				break;
+			case 'j':
+				threads = std::atoi(optarg);
+				break;
+			case 't':
+				allow_text = true;
+				break;
+			case '?':
+				usage();
+				return 1;
+			default:
+				usage();
+				return 2;
+		}
+	}
+	if(optind == argc) {
+		usage();
+		return 1;
+	}
+	if(threads < 1) threads = 1;
+
+	/* Sorted so each level is written in a predictable order. */
+	std::map<std::string, std::vector<std::string>> groups;
+	for(int i = optind; i < argc; ++i) {
+		std::string in(argv[i]);
+		groups[dir + "/" + merged_name(in)].push_back(in);
+	}
+	for(const auto & group : groups) {
+		for(int i = optind; i < argc; ++i) {
+			if(same_file(group.first, argv[i])) {
+				std::cerr << "Output " << group.first << " would overwrite an input"
+					<< std::endl;
+				return -1;
+			}
+		}
+	}
+	for(const auto & group : groups) {
+		long long count = merge(group.second, group.first, threads, allow_text);
+		if(count < 0) return -1;
+		std::cerr << group.first << ": " << count << " unique records from "
+			<< group.second.size() << " files" << std::endl;
+	}
+	return 0;
+}
+